@@ -13,8 +13,35 @@ CONTRACT decocontract : public contract {
     using contract::contract;
 
     decocontract(name receiver, name code, datastream<const char*> ds) : contract(receiver, code, ds),
-      _config(receiver, receiver.value), _bidders(receiver, receiver.value), _stakers(receiver, receiver.value), _registrations(receiver, receiver.value),
-      _referrals(receiver, receiver.value), _tokens(receiver, receiver.value) {}
+      _config(receiver, receiver.value), _totals(receiver, receiver.value), _emission(receiver, receiver.value), _bidders(receiver, receiver.value), _stakers(receiver, receiver.value),
+      _registrations(receiver, receiver.value), _referrals(receiver, receiver.value), _tokens(receiver, receiver.value) {}
+
+    // Result of getstakes, one entry per stake of the account
+    struct stake_view {
+      uint32_t key;
+      eosio::asset staked_amount;
+      int staked_days;
+      int days_passed;
+      int days_to_maturity;
+      bool matured;
+      eosio::asset interest;
+      eosio::asset withdrawable;
+    };
+
+    // Result of getpayout, what the account gets from the next distanddiv and the streamed tokens not claimed yet
+    struct payout_view {
+      eosio::asset dividend;
+      eosio::asset bid_reward;
+      eosio::asset referral_commission;
+      eosio::asset streamed;
+    };
+
+    // Result of getpool, the totals of the running round, the weights of the running round and the streaming stakes when streamed
+    struct pool_view {
+      eosio::asset total_bid;
+      eosio::asset dividend_pool;
+      eosio::asset total_staked;
+    };
     
     ACTION registeruser(name user, uint32_t referral_id);
     
@@ -44,6 +71,18 @@ CONTRACT decocontract : public contract {
     // The action to distribute the minted tokens and give dividend
     ACTION distanddiv(eosio::asset quantity);
 
+    // The action to withdraw the whole credited balance of a token in one transfer per token contract
+    ACTION withdraw(name account, eosio::symbol sym);
+
+    // The action to switch new bids and stakes to the streamed emission and set its rates and budget, disabling settles every stream and returns the stakes to the daily rounds
+    ACTION setemission(bool enabled, int64_t bid_rate, int64_t stake_rate, eosio::asset budget);
+
+    // The action to credit the streamed tokens and dividend of the bid and stakes of the account
+    ACTION claim(name account);
+
+    // The action to bring the stream up to now, every action touching the stream does it as well
+    ACTION catchup();
+
     // The actions to clear all table
     ACTION clearbids();
     ACTION clearstakes();
@@ -63,6 +102,14 @@ CONTRACT decocontract : public contract {
 
     ACTION init();
 
+    // Recompute the pool totals from the bids and stakes tables
+    ACTION synctotals();
+
+    // Read-only actions returning computed values, meant to be called in dry-run transactions
+    [[eosio::action]] std::vector<stake_view> getstakes(name staker);
+    [[eosio::action]] payout_view getpayout(name account, eosio::asset quantity);
+    [[eosio::action]] pool_view getpool();
+
   private:
 
     // Table to hold the settings of the smart contract
@@ -86,6 +133,35 @@ CONTRACT decocontract : public contract {
     typedef singleton<name("contconfig"),contconfig> config_table;
     config_table _config;
 
+    // Table to hold the running totals so they don't need a full table scan
+    TABLE pooltotals {
+      int64_t total_bid;
+      int64_t total_staked;
+    };
+    typedef singleton<name("pooltotals"),pooltotals> totals_table;
+    totals_table _totals;
+
+    // Table to hold the streamed emission, the accumulators are the tokens per unit of weight scaled by ACC_PRECISION
+    TABLE emission_state {
+      bool enabled;
+      int64_t bid_rate;
+      int64_t stake_rate;
+      int64_t budget;
+      uint32_t last_update;
+      uint32_t round_end;
+      uint32_t round_bids;
+      int64_t round_bid_weight;
+      int64_t stake_weight;
+      uint128_t bid_acc;
+      uint128_t stake_acc;
+      uint128_t div_acc;
+    };
+    typedef singleton<name("emission"),emission_state> emission_table;
+    emission_table _emission;
+
+    static constexpr uint128_t ACC_PRECISION = 1000000000000;
+    static constexpr uint32_t SECONDS_PER_DAY = 86400;
+
     // Tabke to hold data about every bidder
     TABLE bidder_info {
       name biddername;
@@ -142,6 +218,54 @@ CONTRACT decocontract : public contract {
     typedef multi_index<name("refs"), referral_info, eosio::indexed_by<name("secid"), eosio::const_mem_fun<referral_info, uint64_t, &referral_info::by_secondary>>> referral_table;
     referral_table _referrals;
 
+    // Table to store the payouts credited to an account, scoped by the account, one row per token contract and symbol
+    TABLE balance_info {
+      uint64_t key;
+      eosio::asset balance;
+      name token_contract;
+
+      auto primary_key() const { return key; }
+      uint128_t by_token() const { return (((uint128_t)token_contract.value) << 64) | balance.symbol.code().raw(); }
+    };
+    typedef multi_index<name("balances"), balance_info, eosio::indexed_by<name("bytoken"), eosio::const_mem_fun<balance_info, uint128_t, &balance_info::by_token>>> balances_table;
+
+    // Table to store the streamed bids, a bid streams until the end of its round
+    TABLE streambid_info {
+      name bidder;
+      int64_t bid;
+      uint32_t round_end;
+      uint128_t paid_acc;
+
+      auto primary_key() const { return bidder.value; }
+    };
+    typedef multi_index<name("streambids"), streambid_info> streambids_table;
+
+    // Table to store the bid accumulator at the end of each round which still has unsettled bids
+    TABLE round_info {
+      uint32_t round_end;
+      uint128_t end_acc;
+      uint32_t open_bids;
+
+      auto primary_key() const { return round_end; }
+    };
+    typedef multi_index<name("rounds"), round_info> rounds_table;
+
+    // Table to store the streamed stakes, keyed like the stakes table, a stake streams until it matures
+    TABLE streamstake_info {
+      uint32_t key;
+      int64_t weight;
+      uint32_t end_time;
+      bool ended;
+      uint128_t paid_acc;
+      uint128_t paid_div_acc;
+      uint128_t end_acc;
+      uint128_t end_div_acc;
+
+      auto primary_key() const { return key; }
+      uint64_t by_end() const { return ended ? UINT64_MAX : end_time; }
+    };
+    typedef multi_index<name("streamstakes"), streamstake_info, eosio::indexed_by<name("byend"), eosio::const_mem_fun<streamstake_info, uint64_t, &streamstake_info::by_end>>> streamstakes_table;
+
     // Tokens to give for each bidded token
     int64_t per_token_rate(int64_t total_supply);
 
@@ -154,6 +278,36 @@ CONTRACT decocontract : public contract {
     // Calculate the interest to give
     int64_t interest_to_give(int64_t amt, int no_of_days, int maturity_days);
 
+    // Add the given amounts to the pool totals
+    void update_totals(int64_t bid_delta, int64_t staked_delta);
+
+    // Credit the payout to the balance of the account
+    void credit(name account, eosio::asset quantity, name token_contract);
+
+    // Whether new bids and stakes go to the stream
+    bool streaming();
+
+    // Move the accumulators forward to the given time, spending the budget
+    void advance(emission_state& state, uint32_t to);
+
+    // Bring the stream up to now, closing the rounds and stakes which ended on the way, and store it
+    emission_state accrue();
+
+    // Days passed of the stake, counted from its start time when it is streamed
+    int stake_days_passed(const staker_info& stake);
+
+    // Add a bid to the running round of the stream
+    void stream_bid(name bidder, int64_t amount);
+
+    // Credit the streamed tokens of the bid with the referral shares, the bid is erased once its round ended
+    bool settle_bid(name bidder, emission_state& state);
+
+    // Credit the streamed tokens and dividend of the stake, the row is erased when close is set
+    bool settle_stake(name staker, uint32_t key, emission_state& state, bool close);
+
+    // Settle and remove the stream of a stake that leaves the stakes table
+    void close_stake(name staker, uint32_t key);
+
     // Distribute divident among the stakers
     void distdivident();
 
@@ -2,13 +2,7 @@
 
 int64_t decocontract::total_bidded_tokens_to_distribute() {
 
-  int64_t total_token_received = 0;
-
-  auto iterator = _bidders.begin();
-  while(iterator != _bidders.end()) {
-    total_token_received = total_token_received + (iterator->bid);
-    iterator++;
-  }
+  int64_t total_token_received = _totals.get_or_default().total_bid;
 
   int64_t tokens_to_distribute = (_config.get().percentage_share_to_distribute * total_token_received) / 100;
 
@@ -17,18 +11,20 @@ int64_t decocontract::total_bidded_tokens_to_distribute() {
 
 int64_t decocontract::total_staked_tokens() {
 
-  int64_t total_staked_tks = 0;
+  // Only the stakes which have passed at least one day are counted
+  return _totals.get_or_default().total_staked;
+}
 
-  auto iterator = _stakers.begin();
-  while(iterator != _stakers.end()) {
-    if(iterator->days_passed > 0) {
-      total_staked_tks = total_staked_tks + iterator->staked_amount;
-    }
+void decocontract::update_totals(int64_t bid_delta, int64_t staked_delta) {
 
-    iterator++;
-  }
+  // Until synctotals has run the totals are counted from the tables
+  if(!_totals.exists())
+    return;
 
-  return total_staked_tks;
+  auto totals_stored = _totals.get_or_default();
+  totals_stored.total_bid = totals_stored.total_bid + bid_delta;
+  totals_stored.total_staked = totals_stored.total_staked + staked_delta;
+  _totals.set(totals_stored, get_self());
 }
 
 int64_t decocontract::interest_to_give(int64_t amt, int no_of_days, int maturity_days) {
@@ -44,6 +40,288 @@ int64_t decocontract::interest_to_give(int64_t amt, int no_of_days, int maturity
   return (interest + extra_interest);
 }
 
+bool decocontract::streaming() {
+  return _emission.exists() && _emission.get().enabled;
+}
+
+void decocontract::advance(emission_state& state, uint32_t to) {
+
+  if(to <= state.last_update)
+    return;
+
+  uint128_t elapsed = to - state.last_update;
+  state.last_update = to;
+
+  // Nothing is emitted while there is no weight to emit to
+  uint128_t bid_emit = (state.bid_rate > 0 && state.round_bid_weight > 0) ? elapsed * state.bid_rate : 0;
+  uint128_t stake_emit = (state.stake_rate > 0 && state.stake_weight > 0) ? elapsed * state.stake_rate : 0;
+
+  // The bid emission reserves the referral shares which are paid on top of it
+  uint128_t referral_factor = 100 + _config.get().referral_percentage + _config.get().having_a_referral_percentage;
+  uint128_t budget = state.budget > 0 ? state.budget : 0;
+  uint128_t needed = ((bid_emit * referral_factor) / 100) + stake_emit;
+
+  // The rates are cut down to what is left of the budget
+  if(needed > budget) {
+    bid_emit = (bid_emit * budget) / needed;
+    stake_emit = (stake_emit * budget) / needed;
+  }
+
+  uint128_t spent = ((bid_emit * referral_factor) / 100) + stake_emit;
+  state.budget = state.budget - (int64_t)(spent < budget ? spent : budget);
+
+  if(bid_emit > 0)
+    state.bid_acc = state.bid_acc + ((bid_emit * ACC_PRECISION) / state.round_bid_weight);
+
+  if(stake_emit > 0)
+    state.stake_acc = state.stake_acc + ((stake_emit * ACC_PRECISION) / state.stake_weight);
+}
+
+decocontract::emission_state decocontract::accrue() {
+
+  auto state = _emission.get();
+  uint32_t now = current_time_point().sec_since_epoch();
+
+  streamstakes_table streamstakes(get_self(), get_self().value);
+  auto by_end = streamstakes.get_index<name("byend")>();
+
+  // Round ends and maturities are handled in time order so each one sees the right weights
+  while(true) {
+
+    auto stake_itr = by_end.begin();
+    bool stake_due = (stake_itr != by_end.end()) && (stake_itr->by_end() <= now);
+    bool round_due = (state.round_end > 0) && (state.round_end <= now);
+
+    if(!stake_due && !round_due)
+      break;
+
+    if(round_due && (!stake_due || state.round_end <= stake_itr->end_time)) {
+      advance(state, state.round_end);
+
+      // The bids of the round stop streaming, the accumulator is kept until they are all settled
+      if(state.round_bids > 0) {
+        rounds_table rounds(get_self(), get_self().value);
+        rounds.emplace(get_self(), [&](auto& row){
+          row.round_end = state.round_end;
+          row.end_acc = state.bid_acc;
+          row.open_bids = state.round_bids;
+        });
+      }
+
+      state.round_end = 0;
+      state.round_bids = 0;
+      state.round_bid_weight = 0;
+    } else {
+      advance(state, stake_itr->end_time);
+
+      // The matured stake stops streaming
+      state.stake_weight = state.stake_weight - stake_itr->weight;
+      by_end.modify(stake_itr, get_self(), [&](auto& row){
+        row.ended = true;
+        row.end_acc = state.stake_acc;
+        row.end_div_acc = state.div_acc;
+      });
+    }
+  }
+
+  advance(state, now);
+
+  _emission.set(state, get_self());
+  return state;
+}
+
+int decocontract::stake_days_passed(const staker_info& stake) {
+
+  streamstakes_table streamstakes(get_self(), get_self().value);
+  auto iterator = streamstakes.find(stake.key);
+
+  if(iterator == streamstakes.end())
+    return stake.days_passed;
+
+  // A streamed stake doesn't wait for distanddiv to count its days
+  uint32_t start = iterator->end_time - (stake.staked_days * SECONDS_PER_DAY);
+  uint32_t now = current_time_point().sec_since_epoch();
+  int days = (now > start) ? (int)((now - start) / SECONDS_PER_DAY) : 0;
+
+  return (days > stake.days_passed) ? days : stake.days_passed;
+}
+
+void decocontract::stream_bid(name bidder, int64_t amount) {
+
+  uint32_t now = current_time_point().sec_since_epoch();
+  auto state = accrue();
+
+  // The dividend share of the bid goes straight to the stakes streaming now
+  int64_t dividend = (_config.get().percentage_share_to_distribute * amount) / 100;
+  if(dividend > 0 && state.stake_weight > 0)
+    state.div_acc = state.div_acc + (((uint128_t)dividend * ACC_PRECISION) / state.stake_weight);
+
+  // The first bid after a round ended opens the next one, which ends at the day boundary
+  if(state.round_end == 0)
+    state.round_end = ((now / SECONDS_PER_DAY) + 1) * SECONDS_PER_DAY;
+
+  // The previous bid is settled first, and erased when it was from an earlier round
+  settle_bid(bidder, state);
+
+  streambids_table streambids(get_self(), get_self().value);
+  auto iterator = streambids.find(bidder.value);
+
+  if(iterator == streambids.end()) {
+    streambids.emplace(get_self(), [&](auto& row){
+      row.bidder = bidder;
+      row.bid = amount;
+      row.round_end = state.round_end;
+      row.paid_acc = state.bid_acc;
+    });
+    state.round_bids = state.round_bids + 1;
+  } else {
+    streambids.modify(iterator, get_self(), [&](auto& row){
+      row.bidder = row.bidder;
+      row.bid = row.bid + amount;
+      row.round_end = row.round_end;
+      row.paid_acc = state.bid_acc;
+    });
+  }
+
+  state.round_bid_weight = state.round_bid_weight + amount;
+  _emission.set(state, get_self());
+}
+
+bool decocontract::settle_bid(name bidder, emission_state& state) {
+
+  streambids_table streambids(get_self(), get_self().value);
+  auto iterator = streambids.find(bidder.value);
+
+  if(iterator == streambids.end())
+    return false;
+
+  bool closed = iterator->round_end != state.round_end;
+  uint128_t acc = state.bid_acc;
+
+  if(closed) {
+    rounds_table rounds(get_self(), get_self().value);
+    auto round = rounds.find(iterator->round_end);
+    check(round != rounds.end(), "the round of the bid is missing");
+
+    acc = round->end_acc;
+
+    // The round is dropped with its last bid
+    if(round->open_bids <= 1)
+      rounds.erase(round);
+    else {
+      rounds.modify(round, get_self(), [&](auto& row){
+        row.round_end = row.round_end;
+        row.end_acc = row.end_acc;
+        row.open_bids = row.open_bids - 1;
+      });
+    }
+  }
+
+  int64_t tokens_to_send = (int64_t)((iterator->bid * (acc - iterator->paid_acc)) / ACC_PRECISION);
+
+  if(closed)
+    streambids.erase(iterator);
+  else {
+    streambids.modify(iterator, get_self(), [&](auto& row){
+      row.bidder = row.bidder;
+      row.bid = row.bid;
+      row.round_end = row.round_end;
+      row.paid_acc = acc;
+    });
+  }
+
+  if(tokens_to_send <= 0)
+    return false;
+
+  // Same referral shares as distribute
+  int64_t referral_share = (_config.get().referral_percentage * tokens_to_send) / 100;
+  auto ref = _referrals.find(bidder.value);
+
+  if((ref != _referrals.end()) && (referral_share > 0)) {
+    credit(ref->referrer, eosio::asset(referral_share, _config.get().stake_symbol), _config.get().stake_contract);
+
+    // Calculating the extra commission for having a referrer
+    int64_t extra = (_config.get().having_a_referral_percentage * tokens_to_send) / 100;
+    tokens_to_send = tokens_to_send + extra;
+  }
+
+  credit(bidder, eosio::asset(tokens_to_send, _config.get().stake_symbol), _config.get().stake_contract);
+  return true;
+}
+
+bool decocontract::settle_stake(name staker, uint32_t key, emission_state& state, bool close) {
+
+  streamstakes_table streamstakes(get_self(), get_self().value);
+  auto iterator = streamstakes.find(key);
+
+  if(iterator == streamstakes.end())
+    return false;
+
+  // A matured stake only gets what was streamed up to its maturity
+  uint128_t acc = iterator->ended ? iterator->end_acc : state.stake_acc;
+  uint128_t div_acc = iterator->ended ? iterator->end_div_acc : state.div_acc;
+
+  int64_t streamed = (int64_t)((iterator->weight * (acc - iterator->paid_acc)) / ACC_PRECISION);
+  int64_t dividend = (int64_t)((iterator->weight * (div_acc - iterator->paid_div_acc)) / ACC_PRECISION);
+
+  if(close) {
+    if(!iterator->ended)
+      state.stake_weight = state.stake_weight - iterator->weight;
+    streamstakes.erase(iterator);
+  } else {
+    streamstakes.modify(iterator, get_self(), [&](auto& row){
+      row.paid_acc = acc;
+      row.paid_div_acc = div_acc;
+    });
+  }
+
+  if(streamed > 0)
+    credit(staker, eosio::asset(streamed, _config.get().stake_symbol), _config.get().stake_contract);
+
+  if(dividend > 0)
+    credit(staker, eosio::asset(dividend, _config.get().hodl_symbol), _config.get().hodl_contract);
+
+  return (streamed > 0) || (dividend > 0);
+}
+
+void decocontract::close_stake(name staker, uint32_t key) {
+
+  // Stakes of the daily rounds have nothing streamed
+  if(!_emission.exists())
+    return;
+
+  streamstakes_table streamstakes(get_self(), get_self().value);
+  if(streamstakes.find(key) == streamstakes.end())
+    return;
+
+  auto state = accrue();
+  settle_stake(staker, key, state, true);
+  _emission.set(state, get_self());
+}
+
+void decocontract::credit(name account, eosio::asset quantity, name token_contract) {
+
+  balances_table balances(get_self(), account.value);
+
+  // A balance of the same symbol from another token contract, like one credited before a setconfig, stays apart
+  auto by_token = balances.get_index<name("bytoken")>();
+  auto iterator = by_token.find((((uint128_t)token_contract.value) << 64) | quantity.symbol.code().raw());
+
+  if(iterator == by_token.end()) {
+    balances.emplace(get_self(), [&](auto& row){
+      row.key = balances.available_primary_key();
+      row.balance = quantity;
+      row.token_contract = token_contract;
+    });
+  } else {
+    by_token.modify(iterator, get_self(), [&](auto& row){
+      row.key = row.key;
+      row.balance = row.balance + quantity;
+      row.token_contract = row.token_contract;
+    });
+  }
+}
+
 void decocontract::distdivident() {
 
   require_auth(get_self());
@@ -51,6 +329,7 @@ void decocontract::distdivident() {
   auto iterator = _stakers.begin();
   int64_t t_staked_tokens = total_staked_tokens();
   int64_t t_bidded_tokens_to_distribute = total_bidded_tokens_to_distribute();
+  int64_t staked_delta = 0;
 
   while(iterator != _stakers.end()) {
   
@@ -58,37 +337,33 @@ void decocontract::distdivident() {
 
       int64_t tokens_to_give = ((iterator->staked_amount) * t_bidded_tokens_to_distribute) / t_staked_tokens;
 
-      if(tokens_to_give > 0) {
-      
-        action {
-          permission_level(get_self(), "active"_n),
-          "eosio.token"_n,
-          "transfer"_n,
-          std::make_tuple(
-            get_self(),
-            iterator->staker,
-            eosio::asset(tokens_to_give, _config.get().hodl_symbol),
-            std::string("Giving Dividend")
-          )
-        }.send();
-      }
+      if(tokens_to_give > 0)
+        credit(iterator->staker, eosio::asset(tokens_to_give, _config.get().hodl_symbol), _config.get().hodl_contract);
     }
 
     // Clear the records after max_unwithdrawn_time
-    if(iterator->days_passed > (iterator->staked_days + _config.get().max_unwithdrawn_time))
-      _stakers.erase(iterator);
-    else {
-    
+    if(iterator->days_passed > (iterator->staked_days + _config.get().max_unwithdrawn_time)) {
+      staked_delta = staked_delta - iterator->staked_amount;
+      close_stake(iterator->staker, iterator->key);
+      iterator = _stakers.erase(iterator);
+    } else {
+
+      // The stake starts counting in the pool after its first day
+      if(iterator->days_passed == 0)
+        staked_delta = staked_delta + iterator->staked_amount;
+
       _stakers.modify(iterator, get_self(), [&](auto& row){
         row.staker = row.staker;
         row.staked_amount = row.staked_amount;
         row.staked_days = row.staked_days;
         row.days_passed = row.days_passed + 1;
       });
-    }
 
-    iterator++;
+      iterator++;
+    }
   }
+
+  update_totals(0, staked_delta);
 }
 
 void decocontract::distribute(eosio::asset quantity) {
@@ -96,14 +371,8 @@ void decocontract::distribute(eosio::asset quantity) {
   // Only the account containing the contract can distribute
   require_auth(get_self());
 
-  // Calculate the total bid
-  int64_t total_bid = 0;
-
-  auto itr = _bidders.begin();
-  while(itr != _bidders.end()) {
-    total_bid = total_bid + (itr->bid);
-    itr++;
-  }
+  // The total bid of the round
+  int64_t total_bid = _totals.get_or_default().total_bid;
 
   auto iterator = _bidders.begin();
   while(iterator != _bidders.end()) {
@@ -116,39 +385,21 @@ void decocontract::distribute(eosio::asset quantity) {
     if((iterator->referrer.length() > 0) && (referral_share > 0)) {
     
       name receiver = eosio::name(iterator->referrer);
-      action {
-        permission_level(get_self(), "active"_n),
-        "destinytoken"_n,
-        "transfer"_n,
-        std::make_tuple(
-          get_self(),
-          receiver,
-          eosio::asset(referral_share, quantity.symbol),
-          std::string("Commission for Referring")
-        )
-      }.send();
+      credit(receiver, eosio::asset(referral_share, quantity.symbol), _config.get().stake_contract);
 
       // Calculating the extra commission for having a referrer
       int64_t extra = (_config.get().having_a_referral_percentage * tokens_to_send) / 100;
       tokens_to_send = tokens_to_send + extra;
     }
 
-    if(tokens_to_send > 0) {
-      action {
-        permission_level(get_self(), "active"_n),
-        "destinytoken"_n,
-        "transfer"_n,
-        std::make_tuple(
-          get_self(),
-          iterator->biddername,
-          eosio::asset(tokens_to_send, quantity.symbol),
-          std::string("Delegated Tokens + Bonus if any")
-        )
-      }.send(); 
-    }
+    if(tokens_to_send > 0)
+      credit(iterator->biddername, eosio::asset(tokens_to_send, quantity.symbol), _config.get().stake_contract);
 
     iterator = _bidders.erase(iterator);
   }
+
+  // All the bids of the round are settled
+  update_totals(-total_bid, 0);
 }
 
 ACTION decocontract::registeruser(name user, uint32_t referral_id) {
@@ -194,6 +445,7 @@ void decocontract::bid(name hodler, name to, eosio::asset quantity, std::string
   check(_config.get().freeze_level == 0, "contract under freeze for maintainance");
 
   check(_config.get().hodl_contract == get_first_receiver(), "This contract is not accepted for bidding");
+  check(_totals.exists(), "run synctotals first");
 
   check(quantity.amount > 0, "quantity must be greater than 0");
   check(quantity.amount <= _config.get().max_bid_amount, "more than max bid limit");
@@ -204,6 +456,11 @@ void decocontract::bid(name hodler, name to, eosio::asset quantity, std::string
   auto reg_itr = reg.find(hodler.value);
   check(reg_itr != reg.end(), "account is not registered");
 
+  if(streaming()) {
+    stream_bid(hodler, quantity.amount);
+    return;
+  }
+
   string referrer_account = "";
   auto ref = _referrals.find(hodler.value);
 
@@ -227,6 +484,8 @@ void decocontract::bid(name hodler, name to, eosio::asset quantity, std::string
       row.referrer = referrer_account;
     });
   }
+
+  update_totals(quantity.amount, 0);
 }
 
 [[eosio::on_notify("*::transfer")]]
@@ -284,17 +543,7 @@ ACTION decocontract::reducestake(name staker, eosio::asset quantity) {
     _tokens.erase(iterator);
   }
 
-  action {
-    permission_level(get_self(), "active"_n),
-    "destinytoken"_n,
-    "transfer"_n,
-    std::make_tuple(
-      get_self(),
-      staker,
-      quantity,
-      std::string("Withdrawing tokens from pending stake")
-    )
-  }.send();
+  credit(staker, quantity, _config.get().stake_contract);
 }
 
 ACTION decocontract::setstake(name staker, int days) {
@@ -311,15 +560,36 @@ ACTION decocontract::setstake(name staker, int days) {
 
   eosio::asset tk = iterator->tokens;
   int64_t amt = tk.amount;
+  uint32_t key = current_time_point().sec_since_epoch();
 
   _stakers.emplace(get_self(), [&](auto& row){
-    row.key = current_time_point().sec_since_epoch();
+    row.key = key;
     row.staker = staker;
     row.staked_amount = amt;
     row.staked_days = days;
     row.days_passed = 0;
   });
 
+  // The stake streams from now until it matures
+  if(streaming()) {
+    auto state = accrue();
+
+    streamstakes_table streamstakes(get_self(), get_self().value);
+    streamstakes.emplace(get_self(), [&](auto& row){
+      row.key = key;
+      row.weight = amt;
+      row.end_time = key + (days * SECONDS_PER_DAY);
+      row.ended = false;
+      row.paid_acc = state.stake_acc;
+      row.paid_div_acc = state.div_acc;
+      row.end_acc = 0;
+      row.end_div_acc = 0;
+    });
+
+    state.stake_weight = state.stake_weight + amt;
+    _emission.set(state, get_self());
+  }
+
   _tokens.erase(iterator);
 }
 
@@ -329,6 +599,8 @@ ACTION decocontract::transferdiv(uint32_t key) {
   require_auth(get_self());
 
   check(_config.get().freeze_level == 0, "contract under freeze for maintainance");
+  check(_totals.exists(), "run synctotals first");
+  check(!streaming(), "the dividend is streamed");
 
   auto iterator = _stakers.find(key);
   check(iterator != _stakers.end(), "the given key is not in the stakers table");
@@ -337,26 +609,21 @@ ACTION decocontract::transferdiv(uint32_t key) {
 
     int64_t tokens_to_give = (((iterator->staked_amount) * total_bidded_tokens_to_distribute()) / (total_staked_tokens()));
 
-    if(tokens_to_give > 0) {
-      action {
-        permission_level(get_self(), "active"_n),
-        "eosio.token"_n,
-        "transfer"_n,
-        std::make_tuple(
-          get_self(),
-          iterator->staker,
-          eosio::asset(tokens_to_give, _config.get().hodl_symbol),
-          std::string("Giving Dividend")
-        )
-      }.send();
-    }
+    if(tokens_to_give > 0)
+      credit(iterator->staker, eosio::asset(tokens_to_give, _config.get().hodl_symbol), _config.get().hodl_contract);
   }
 
   if(iterator->days_passed > iterator->staked_days + _config.get().max_unwithdrawn_time) {
+    update_totals(0, -iterator->staked_amount);
+    close_stake(iterator->staker, iterator->key);
     _stakers.erase(iterator);
     return;
   }
 
+  // The stake starts counting in the pool after its first day
+  if(iterator->days_passed == 0)
+    update_totals(0, iterator->staked_amount);
+
   _stakers.modify(iterator, get_self(), [&](auto& row){
     row.staker = row.staker;
     row.staked_amount = row.staked_amount;
@@ -374,25 +641,21 @@ ACTION decocontract::cancelstake(name staker, uint32_t key) {
   auto iterator = _stakers.find(key);
   check(iterator != _stakers.end(), "the given key is not in the stakers table");
   check(iterator->staker == staker, "the account name doesn't match with the staker name");
-  check(iterator->staked_days >= iterator->days_passed, "account is matured and can be withdrawn");
+
+  int days_passed = stake_days_passed(*iterator);
+  check(iterator->staked_days >= days_passed, "account is matured and can be withdrawn");
 
   // They are penalized for early withdrawal
-  int64_t amt_to_give = (((100 - _config.get().early_withdraw_penalty) * iterator->staked_amount) / 100) + interest_to_give(iterator->staked_amount, iterator->days_passed, iterator->staked_days);
+  int64_t amt_to_give = (((100 - _config.get().early_withdraw_penalty) * iterator->staked_amount) / 100) + interest_to_give(iterator->staked_amount, days_passed, iterator->staked_days);
 
   check(amt_to_give > 0, "No token to withdraw");
 
-  action {
-    permission_level(get_self(), "active"_n),
-    "destinytoken"_n,
-    "transfer"_n,
-    std::make_tuple(
-      get_self(),
-      staker,
-      eosio::asset(amt_to_give, _config.get().stake_symbol),
-      std::string("Premature Withdraw of Stake")
-    )
-  }.send();
+  credit(staker, eosio::asset(amt_to_give, _config.get().stake_symbol), _config.get().stake_contract);
+
+  if(iterator->days_passed > 0)
+    update_totals(0, -iterator->staked_amount);
 
+  close_stake(staker, key);
   _stakers.erase(iterator);
 }
 
@@ -405,24 +668,21 @@ ACTION decocontract::withdrawstake(name staker, uint32_t key) {
   auto iterator = _stakers.find(key);
   check(iterator != _stakers.end(), "the given key is not in the stakers table");
   check(iterator->staker == staker, "the account name doesn't match with the staker name");
-  check(iterator->staked_days < iterator->days_passed, "stake still not matured");
 
-  int64_t amt_to_give = iterator->staked_amount + interest_to_give(iterator->staked_amount, iterator->days_passed, iterator->staked_days);
+  int days_passed = stake_days_passed(*iterator);
+  check(iterator->staked_days < days_passed, "stake still not matured");
+
+  int64_t amt_to_give = iterator->staked_amount + interest_to_give(iterator->staked_amount, days_passed, iterator->staked_days);
 
   check(amt_to_give > 0, "no token to withdraw");
 
-  action {
-    permission_level(get_self(), "active"_n),
-    "destinytoken"_n,
-    "transfer"_n,
-    std::make_tuple(
-      get_self(),
-      staker,
-      eosio::asset(amt_to_give, _config.get().stake_symbol),
-      std::string("Withdraw stake with interest")
-    )
-  }.send();
+  credit(staker, eosio::asset(amt_to_give, _config.get().stake_symbol), _config.get().stake_contract);
 
+  // A streamed stake never passes a daily round so it was never counted in the totals
+  if(iterator->days_passed > 0)
+    update_totals(0, -iterator->staked_amount);
+
+  close_stake(staker, key);
   _stakers.erase(iterator);
 }
 
@@ -431,10 +691,194 @@ ACTION decocontract::distanddiv(eosio::asset supply) {
   require_auth(get_self());
 
   check(_config.get().freeze_level == 0, "contract under freeze for maintainance");
-  
+  check(_totals.exists(), "run synctotals first");
+  check(supply.symbol == _config.get().stake_symbol, "this token is not distributed");
+
+  check(!streaming(), "the rounds are streamed");
+
   distdivident();
   distribute(supply);
+}
+
+ACTION decocontract::withdraw(name account, eosio::symbol sym) {
+
+  require_auth(account);
+
+  check(_config.get().freeze_level == 0, "contract under freeze for maintainance");
+
+  balances_table balances(get_self(), account.value);
+  bool withdrawn = false;
+
+  // All the credited payouts of a token contract are sent in a single transfer
+  auto iterator = balances.begin();
+  while(iterator != balances.end()) {
+
+    if(iterator->balance.symbol.code() != sym.code()) {
+      iterator++;
+      continue;
+    }
+
+    check(iterator->balance.symbol == sym, "Symbol doesnt match with the balance");
+
+    if(iterator->balance.amount > 0) {
+      action {
+        permission_level(get_self(), "active"_n),
+        iterator->token_contract,
+        "transfer"_n,
+        std::make_tuple(
+          get_self(),
+          account,
+          iterator->balance,
+          std::string("Withdraw balance")
+        )
+      }.send();
+
+      withdrawn = true;
+    }
+
+    iterator = balances.erase(iterator);
+  }
+
+  check(withdrawn, "no balance to withdraw");
+}
+
+ACTION decocontract::setemission(bool enabled, int64_t bid_rate, int64_t stake_rate, eosio::asset budget) {
+
+  require_auth(get_self());
+
+  check(bid_rate >= 0 && stake_rate >= 0, "rates must not be negative");
+  check(budget.symbol == _config.get().stake_symbol, "budget must be in the stake token");
+  check(budget.amount >= 0, "budget must not be negative");
+
+  uint32_t now = current_time_point().sec_since_epoch();
+  emission_state state = {};
+
+  if(_emission.exists()) {
+    // Accrue at the old rates up to now, the new rates apply from here
+    state = accrue();
+  }
+
+  if(enabled && !state.enabled) {
+
+    // Bids of the daily round would never be distributed once the rounds are streamed
+    check(_bidders.begin() == _bidders.end(), "close the daily round with distanddiv first");
+
+    // Stakes of the daily rounds stream from now until they mature
+    streamstakes_table streamstakes(get_self(), get_self().value);
+
+    auto stake_itr = _stakers.begin();
+    while(stake_itr != _stakers.end()) {
+
+      if(streamstakes.find(stake_itr->key) == streamstakes.end()) {
+        uint32_t start = now - (stake_itr->days_passed * SECONDS_PER_DAY);
+        uint32_t end_time = start + (stake_itr->staked_days * SECONDS_PER_DAY);
+        bool ended = end_time <= now;
+
+        streamstakes.emplace(get_self(), [&](auto& row){
+          row.key = stake_itr->key;
+          row.weight = stake_itr->staked_amount;
+          row.end_time = end_time;
+          row.ended = ended;
+          row.paid_acc = state.stake_acc;
+          row.paid_div_acc = state.div_acc;
+          row.end_acc = state.stake_acc;
+          row.end_div_acc = state.div_acc;
+        });
+
+        if(!ended)
+          state.stake_weight = state.stake_weight + stake_itr->staked_amount;
+      }
+
+      stake_itr++;
+    }
+  }
+
+  if(!enabled && state.enabled) {
+
+    // The running round ends now so its bids can be settled
+    if(state.round_end > 0) {
+      if(state.round_bids > 0) {
+        rounds_table rounds(get_self(), get_self().value);
+        rounds.emplace(get_self(), [&](auto& row){
+          row.round_end = state.round_end;
+          row.end_acc = state.bid_acc;
+          row.open_bids = state.round_bids;
+        });
+      }
+
+      state.round_end = 0;
+      state.round_bids = 0;
+      state.round_bid_weight = 0;
+    }
+
+    // Every streamed bid is settled and erased
+    streambids_table streambids(get_self(), get_self().value);
+    while(streambids.begin() != streambids.end())
+      settle_bid(streambids.begin()->bidder, state);
+
+    // Every streamed stake is settled and goes back to the daily rounds with the days it has passed
+    streamstakes_table streamstakes(get_self(), get_self().value);
+    while(streamstakes.begin() != streamstakes.end()) {
+      auto stream_itr = streamstakes.begin();
+      auto stake_itr = _stakers.find(stream_itr->key);
+
+      if(stake_itr == _stakers.end()) {
+        if(!stream_itr->ended)
+          state.stake_weight = state.stake_weight - stream_itr->weight;
+        streamstakes.erase(stream_itr);
+        continue;
+      }
+
+      int days_passed = stake_days_passed(*stake_itr);
+      _stakers.modify(stake_itr, get_self(), [&](auto& row){
+        row.key = row.key;
+        row.staker = row.staker;
+        row.staked_amount = row.staked_amount;
+        row.staked_days = row.staked_days;
+        row.days_passed = days_passed;
+      });
+
+      settle_stake(stake_itr->staker, stake_itr->key, state, true);
+    }
+
+    // The stakes back in the daily rounds are counted again
+    synctotals();
+  }
+
+  state.enabled = enabled;
+  state.bid_rate = bid_rate;
+  state.stake_rate = stake_rate;
+  state.budget = budget.amount;
+  state.last_update = now;
+  _emission.set(state, get_self());
+}
+
+ACTION decocontract::claim(name account) {
+
+  require_auth(account);
+
+  check(_config.get().freeze_level == 0, "contract under freeze for maintainance");
+  check(_emission.exists(), "run setemission first");
+
+  auto state = accrue();
+  bool claimed = settle_bid(account, state);
+
+  auto stk = _stakers.get_index<name("secid")>();
+  auto stk_itr = stk.lower_bound(account.value);
+
+  while(stk_itr != stk.end() && stk_itr->staker == account) {
+    claimed = settle_stake(account, stk_itr->key, state, false) || claimed;
+    stk_itr++;
+  }
 
+  check(claimed, "no streamed tokens to claim");
+}
+
+ACTION decocontract::catchup() {
+
+  check(_emission.exists(), "run setemission first");
+
+  accrue();
 }
 
 ACTION decocontract::clearbids() {
@@ -444,6 +888,26 @@ ACTION decocontract::clearbids() {
   auto iterator = _bidders.begin();
   while(iterator != _bidders.end())
     iterator = _bidders.erase(iterator);
+
+  streambids_table streambids(get_self(), get_self().value);
+  auto stream_itr = streambids.begin();
+  while(stream_itr != streambids.end())
+    stream_itr = streambids.erase(stream_itr);
+
+  rounds_table rounds(get_self(), get_self().value);
+  auto round_itr = rounds.begin();
+  while(round_itr != rounds.end())
+    round_itr = rounds.erase(round_itr);
+
+  update_totals(-_totals.get_or_default().total_bid, 0);
+
+  if(_emission.exists()) {
+    auto state = _emission.get();
+    state.round_end = 0;
+    state.round_bids = 0;
+    state.round_bid_weight = 0;
+    _emission.set(state, get_self());
+  }
 }
 
 ACTION decocontract::clearstakes() {
@@ -453,6 +917,19 @@ ACTION decocontract::clearstakes() {
   auto iterator = _stakers.begin();
   while(iterator != _stakers.end())
     iterator = _stakers.erase(iterator);
+
+  streamstakes_table streamstakes(get_self(), get_self().value);
+  auto stream_itr = streamstakes.begin();
+  while(stream_itr != streamstakes.end())
+    stream_itr = streamstakes.erase(stream_itr);
+
+  update_totals(0, -_totals.get_or_default().total_staked);
+
+  if(_emission.exists()) {
+    auto state = _emission.get();
+    state.stake_weight = 0;
+    _emission.set(state, get_self());
+  }
 }
 
 ACTION decocontract::cleartokens() {
@@ -553,7 +1030,185 @@ ACTION decocontract::init() {
   config_stored.freeze_level = 0;
   _config.set(config_stored, get_self());
 
+  synctotals();
+}
+
+ACTION decocontract::synctotals() {
+
+  require_auth(get_self());
+
+  pooltotals totals_stored = { 0, 0 };
+
+  auto bid_itr = _bidders.begin();
+  while(bid_itr != _bidders.end()) {
+    totals_stored.total_bid = totals_stored.total_bid + bid_itr->bid;
+    bid_itr++;
+  }
+
+  auto stake_itr = _stakers.begin();
+  while(stake_itr != _stakers.end()) {
+    if(stake_itr->days_passed > 0)
+      totals_stored.total_staked = totals_stored.total_staked + stake_itr->staked_amount;
+    stake_itr++;
+  }
+
+  _totals.set(totals_stored, get_self());
+}
+
+std::vector<decocontract::stake_view> decocontract::getstakes(name staker) {
+
+  std::vector<stake_view> stakes;
+
+  auto stk = _stakers.get_index<name("secid")>();
+  auto stk_itr = stk.lower_bound(staker.value);
+
+  while(stk_itr != stk.end() && stk_itr->staker == staker) {
+
+    int days_passed = stake_days_passed(*stk_itr);
+    bool matured = stk_itr->staked_days < days_passed;
+    int64_t interest = interest_to_give(stk_itr->staked_amount, days_passed, stk_itr->staked_days);
+
+    // Same amounts as withdrawstake and cancelstake would give
+    int64_t withdrawable = matured ? stk_itr->staked_amount + interest
+      : (((100 - _config.get().early_withdraw_penalty) * stk_itr->staked_amount) / 100) + interest;
+
+    stakes.push_back(stake_view{
+      stk_itr->key,
+      eosio::asset(stk_itr->staked_amount, _config.get().stake_symbol),
+      stk_itr->staked_days,
+      days_passed,
+      matured ? 0 : (stk_itr->staked_days - days_passed + 1),
+      matured,
+      eosio::asset(interest, _config.get().stake_symbol),
+      eosio::asset(withdrawable, _config.get().stake_symbol)
+    });
+
+    stk_itr++;
+  }
+
+  return stakes;
+}
+
+decocontract::payout_view decocontract::getpayout(name account, eosio::asset quantity) {
+
+  check(quantity.amount >= 0, "quantity must not be negative");
+  check(quantity.symbol == _config.get().stake_symbol, "this token is not distributed");
+
+  int64_t t_staked_tokens = total_staked_tokens();
+  int64_t t_bidded_tokens_to_distribute = total_bidded_tokens_to_distribute();
+  int64_t total_bid = _totals.get_or_default().total_bid;
+
+  // The stream is read as of its last update, catchup writes so it goes before this in a dry-run (compute) transaction for the latest figures
+  auto state = _emission.get_or_default();
+  streamstakes_table streamstakes(get_self(), get_self().value);
+  streambids_table streambids(get_self(), get_self().value);
+  rounds_table rounds(get_self(), get_self().value);
+
+  // Tokens streamed to a bid and not settled yet, same as settle_bid
+  auto streamed_bid = [&](name bidder) -> int64_t {
+    auto iterator = streambids.find(bidder.value);
+    if(iterator == streambids.end())
+      return 0;
+
+    uint128_t acc = state.bid_acc;
+    if(iterator->round_end != state.round_end) {
+      auto round = rounds.find(iterator->round_end);
+      acc = (round != rounds.end()) ? round->end_acc : iterator->paid_acc;
+    }
+
+    return (int64_t)((iterator->bid * (acc - iterator->paid_acc)) / ACC_PRECISION);
+  };
+
+  // Dividend of the stakes, same as distdivident and settle_stake
+  int64_t dividend = 0;
+
+  // Tokens streamed to the bid and stakes so far, same as claim
+  int64_t streamed = 0;
+
+  auto stk = _stakers.get_index<name("secid")>();
+  auto stk_itr = stk.lower_bound(account.value);
+
+  while(stk_itr != stk.end() && stk_itr->staker == account) {
+    if((stk_itr->days_passed > 0) && (stk_itr->days_passed <= stk_itr->staked_days) && (t_staked_tokens > 0))
+      dividend = dividend + ((stk_itr->staked_amount * t_bidded_tokens_to_distribute) / t_staked_tokens);
+
+    auto stream_itr = streamstakes.find(stk_itr->key);
+    if(stream_itr != streamstakes.end()) {
+      uint128_t acc = stream_itr->ended ? stream_itr->end_acc : state.stake_acc;
+      uint128_t div_acc = stream_itr->ended ? stream_itr->end_div_acc : state.div_acc;
+
+      streamed = streamed + (int64_t)((stream_itr->weight * (acc - stream_itr->paid_acc)) / ACC_PRECISION);
+      dividend = dividend + (int64_t)((stream_itr->weight * (div_acc - stream_itr->paid_div_acc)) / ACC_PRECISION);
+    }
+
+    stk_itr++;
+  }
+
+  // Share of the minted tokens for the own bid, same as distribute
+  int64_t bid_reward = 0;
+
+  auto bid_itr = _bidders.find(account.value);
+  if(bid_itr != _bidders.end() && total_bid > 0) {
+    bid_reward = (bid_itr->bid * quantity.amount) / total_bid;
+
+    int64_t referral_share = (_config.get().referral_percentage * bid_reward) / 100;
+    if((bid_itr->referrer.length() > 0) && (referral_share > 0))
+      bid_reward = bid_reward + ((_config.get().having_a_referral_percentage * bid_reward) / 100);
+  }
+
+  // The streamed bid gets the same bonus for having a referrer
+  int64_t own_streamed = streamed_bid(account);
+  if((_referrals.find(account.value) != _referrals.end()) && (((_config.get().referral_percentage * own_streamed) / 100) > 0))
+    own_streamed = own_streamed + ((_config.get().having_a_referral_percentage * own_streamed) / 100);
+  streamed = streamed + own_streamed;
+
+  // Commission for the bids of the referred accounts
+  int64_t referral_commission = 0;
+
+  auto ref = _referrals.get_index<name("secid")>();
+  auto ref_itr = ref.lower_bound(account.value);
+
+  while(ref_itr != ref.end() && ref_itr->referrer == account) {
+    auto referred_bid = _bidders.find(ref_itr->referred_person.value);
+    if(referred_bid != _bidders.end() && total_bid > 0)
+      referral_commission = referral_commission + ((_config.get().referral_percentage * ((referred_bid->bid * quantity.amount) / total_bid)) / 100);
+
+    // Commission streamed from the bids of the referred accounts, same as settle_bid
+    streamed = streamed + ((_config.get().referral_percentage * streamed_bid(ref_itr->referred_person)) / 100);
+    ref_itr++;
+  }
+
+  return payout_view{
+    eosio::asset(dividend, _config.get().hodl_symbol),
+    eosio::asset(bid_reward, quantity.symbol),
+    eosio::asset(referral_commission, quantity.symbol),
+    eosio::asset(streamed, _config.get().stake_symbol)
+  };
+}
+
+decocontract::pool_view decocontract::getpool() {
+
+  // While streamed the bids and stakes are weights of the emission and never reach the totals
+  if(streaming()) {
+    auto state = _emission.get();
+
+    // A round which ended since the last update has no bids left streaming
+    int64_t round_bid = state.round_bid_weight;
+    if(state.round_end > 0 && state.round_end <= current_time_point().sec_since_epoch())
+      round_bid = 0;
+
+    return pool_view{
+      eosio::asset(round_bid, _config.get().hodl_symbol),
+      eosio::asset((_config.get().percentage_share_to_distribute * round_bid) / 100, _config.get().hodl_symbol),
+      eosio::asset(state.stake_weight, _config.get().stake_symbol)
+    };
+  }
 
+  return pool_view{
+    eosio::asset(_totals.get_or_default().total_bid, _config.get().hodl_symbol),
+    eosio::asset(total_bidded_tokens_to_distribute(), _config.get().hodl_symbol),
+    eosio::asset(total_staked_tokens(), _config.get().stake_symbol)
+  };
 }
 
 // EOSIO_DISPATCH(decocontract, (registeruser)(reducestake)(setstake)(transferdiv)(cancelstake)(withdrawstake)(distanddiv)(clearbids)(clearstakers)(cleartokens)(clearregistr)(clearrefs)(clearall)(setsettings))
@@ -0,0 +1,266 @@
+#include "abi.hpp"
+
+#include <stdexcept>
+
+namespace decosnap {
+
+  namespace {
+
+    class row_reader {
+      public:
+        explicit row_reader(const std::vector<uint8_t>& row) : _row(row) {}
+
+        bool done() const { return _pos >= _row.size(); }
+
+        uint64_t fixed(size_t bytes) {
+          if(_pos + bytes > _row.size())
+            throw std::runtime_error("abi: row is shorter than its struct");
+          uint64_t value = 0;
+          for(size_t i = 0; i < bytes; i++)
+            value |= static_cast<uint64_t>(_row[_pos + i]) << (8 * i);
+          _pos += bytes;
+          return value;
+        }
+
+        uint32_t varuint32() {
+          uint32_t value = 0;
+          for(int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(fixed(1));
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0)
+              return value;
+          }
+          throw std::runtime_error("abi: bad varuint32");
+        }
+
+        std::string bytes(size_t size) {
+          if(_pos + size > _row.size())
+            throw std::runtime_error("abi: row is shorter than its struct");
+          std::string value(_row.begin() + _pos, _row.begin() + _pos + size);
+          _pos += size;
+          return value;
+        }
+
+      private:
+        const std::vector<uint8_t>& _row;
+        size_t _pos = 0;
+    };
+
+    int64_t sign_extend(uint64_t value, size_t bytes) {
+      if(bytes == 8)
+        return static_cast<int64_t>(value);
+      uint64_t sign = 1ULL << (8 * bytes - 1);
+      return static_cast<int64_t>((value ^ sign) - sign);
+    }
+
+    struct builtin {
+      column_kind kind;
+      size_t bytes;
+      bool is_signed;
+    };
+
+    // Builtins stored in a single column, asset is handled on its own
+    const std::map<std::string, builtin> builtins = {
+      { "bool", { column_kind::u64, 1, false } },
+      { "int8", { column_kind::i64, 1, true } },
+      { "uint8", { column_kind::u64, 1, false } },
+      { "int16", { column_kind::i64, 2, true } },
+      { "uint16", { column_kind::u64, 2, false } },
+      { "int32", { column_kind::i64, 4, true } },
+      { "uint32", { column_kind::u64, 4, false } },
+      { "int64", { column_kind::i64, 8, true } },
+      { "uint64", { column_kind::u64, 8, false } },
+      { "uint128", { column_kind::u128, 16, false } },
+      { "int128", { column_kind::u128, 16, false } },
+      { "varuint32", { column_kind::u64, 0, false } },
+      { "time_point_sec", { column_kind::u64, 4, false } },
+      { "time_point", { column_kind::i64, 8, true } },
+      { "name", { column_kind::str, 8, false } },
+      { "symbol", { column_kind::str, 8, false } },
+      { "symbol_code", { column_kind::str, 8, false } },
+      { "string", { column_kind::str, 0, false } },
+      { "checksum256", { column_kind::str, 32, false } }
+    };
+
+    std::string to_hex(const std::string& bytes) {
+      static const char digits[] = "0123456789abcdef";
+      std::string out;
+      for(unsigned char c : bytes) {
+        out += digits[c >> 4];
+        out += digits[c & 0x0f];
+      }
+      return out;
+    }
+
+    void push_default(column& col) {
+      switch(col.kind) {
+        case column_kind::i64: col.i64s.push_back(0); break;
+        case column_kind::u64: col.u64s.push_back(0); break;
+        case column_kind::u128: col.u128s.push_back(0); break;
+        case column_kind::str: col.strs.push_back(""); break;
+      }
+    }
+
+  }
+
+  std::string name_to_string(uint64_t value) {
+    static const char charmap[] = ".12345abcdefghijklmnopqrstuvwxyz";
+    std::string str(13, '.');
+
+    uint64_t tmp = value;
+    for(int i = 0; i <= 12; i++) {
+      char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+      str[12 - i] = c;
+      tmp >>= (i == 0 ? 4 : 5);
+    }
+
+    size_t end = str.find_last_not_of('.');
+    return end == std::string::npos ? "" : str.substr(0, end + 1);
+  }
+
+  std::string symbol_to_string(uint64_t value) {
+    std::string code;
+    for(uint64_t raw = value >> 8; raw > 0; raw >>= 8)
+      code += static_cast<char>(raw & 0xff);
+    return std::to_string(value & 0xff) + "," + code;
+  }
+
+  abi_decoder::abi_decoder(const json_value& abi) {
+    for(const auto& type : abi.at("types").array())
+      _aliases[type.at("new_type_name").str()] = type.at("type").str();
+
+    for(const auto& st : abi.at("structs").array()) {
+      struct_def def;
+      def.base = st.at("base").str();
+      for(const auto& field : st.at("fields").array())
+        def.fields.push_back({ field.at("name").str(), field.at("type").str() });
+      _structs[st.at("name").str()] = def;
+    }
+
+    for(const auto& table : abi.at("tables").array())
+      _tables[table.at("name").str()] = table.at("type").str();
+
+    // Plan every table up front so a bad ABI fails before any row is read
+    for(const auto& table : _tables) {
+      std::vector<leaf> leaves;
+      plan(table.second, "", false, leaves, 0);
+      _plans[table.first] = leaves;
+    }
+  }
+
+  bool abi_decoder::has_table(const std::string& table) const {
+    return _tables.count(table) > 0;
+  }
+
+  std::string abi_decoder::resolve(const std::string& type) const {
+    std::string resolved = type;
+    for(int hops = 0; hops < 32; hops++) {
+      auto iterator = _aliases.find(resolved);
+      if(iterator == _aliases.end())
+        return resolved;
+      resolved = iterator->second;
+    }
+    throw std::runtime_error("abi: alias loop at " + type);
+  }
+
+  void abi_decoder::plan(const std::string& type, const std::string& prefix, bool extension, std::vector<leaf>& leaves, int depth) const {
+    if(depth > 16)
+      throw std::runtime_error("abi: struct nesting too deep at " + type);
+
+    std::string resolved = resolve(type);
+
+    // Binary extensions may be missing at the end of older rows
+    if(!resolved.empty() && resolved.back() == '$') {
+      plan(resolved.substr(0, resolved.size() - 1), prefix, true, leaves, depth + 1);
+      return;
+    }
+
+    if(!resolved.empty() && (resolved.back() == '?' || resolved.back() == ']'))
+      throw std::runtime_error("abi: optional and array fields are not supported (" + prefix + ")");
+
+    if(resolved == "asset") {
+      leaves.push_back({ prefix + ".amount", "int64", extension });
+      leaves.push_back({ prefix + ".symbol", "symbol", extension });
+      return;
+    }
+
+    if(builtins.count(resolved) > 0) {
+      leaves.push_back({ prefix, resolved, extension });
+      return;
+    }
+
+    auto iterator = _structs.find(resolved);
+    if(iterator == _structs.end())
+      throw std::runtime_error("abi: unknown type " + resolved);
+
+    if(!iterator->second.base.empty())
+      plan(iterator->second.base, prefix, extension, leaves, depth + 1);
+
+    for(const auto& field : iterator->second.fields)
+      plan(field.type, prefix.empty() ? field.name : prefix + "." + field.name, extension, leaves, depth + 1);
+  }
+
+  const std::vector<abi_decoder::leaf>& abi_decoder::plan_for(const std::string& table) const {
+    auto iterator = _plans.find(table);
+    if(iterator == _plans.end())
+      throw std::runtime_error("abi: no table " + table);
+    return iterator->second;
+  }
+
+  std::vector<column> abi_decoder::make_columns(const std::string& table) const {
+    std::vector<column> columns;
+    for(const auto& l : plan_for(table)) {
+      column col;
+      col.name = l.column_name;
+      col.kind = builtins.at(l.type).kind;
+      columns.push_back(col);
+    }
+    return columns;
+  }
+
+  void abi_decoder::decode_row(const std::string& table, const std::vector<uint8_t>& row, std::vector<column>& columns, size_t first) const {
+    const auto& leaves = plan_for(table);
+    if(columns.size() != first + leaves.size())
+      throw std::runtime_error("abi: columns don't match table " + table);
+
+    row_reader reader(row);
+
+    for(size_t i = 0; i < leaves.size(); i++) {
+      const leaf& l = leaves[i];
+      column& col = columns[first + i];
+
+      if(l.extension && reader.done()) {
+        push_default(col);
+        continue;
+      }
+
+      const builtin& b = builtins.at(l.type);
+
+      if(l.type == "string") {
+        col.strs.push_back(reader.bytes(reader.varuint32()));
+      } else if(l.type == "varuint32") {
+        col.u64s.push_back(reader.varuint32());
+      } else if(l.type == "name") {
+        col.strs.push_back(name_to_string(reader.fixed(8)));
+      } else if(l.type == "symbol") {
+        col.strs.push_back(symbol_to_string(reader.fixed(8)));
+      } else if(l.type == "symbol_code") {
+        col.strs.push_back(symbol_to_string(reader.fixed(8) << 8).substr(2));
+      } else if(l.type == "checksum256") {
+        col.strs.push_back(to_hex(reader.bytes(32)));
+      } else if(b.kind == column_kind::u128) {
+        __uint128_t low = reader.fixed(8);
+        __uint128_t high = reader.fixed(8);
+        col.u128s.push_back(low | (high << 64));
+      } else if(b.is_signed) {
+        col.i64s.push_back(sign_extend(reader.fixed(b.bytes), b.bytes));
+      } else {
+        col.u64s.push_back(reader.fixed(b.bytes));
+      }
+    }
+
+    if(!reader.done())
+      throw std::runtime_error("abi: row of " + table + " is longer than its struct");
+  }
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "columnar.hpp"
+#include "json.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace decosnap {
+
+  // Decodes table rows with the structs of a contract ABI, nested structs are flattened into dotted columns
+  class abi_decoder {
+    public:
+      explicit abi_decoder(const json_value& abi);
+
+      bool has_table(const std::string& table) const;
+
+      // Empty columns for the table, in the order decode_row fills them
+      std::vector<column> make_columns(const std::string& table) const;
+
+      // Decode one serialized row and append it to the columns starting at first
+      void decode_row(const std::string& table, const std::vector<uint8_t>& row, std::vector<column>& columns, size_t first) const;
+
+    private:
+      struct field_def {
+        std::string name;
+        std::string type;
+      };
+
+      struct struct_def {
+        std::string base;
+        std::vector<field_def> fields;
+      };
+
+      // One builtin value read from the row into a column
+      struct leaf {
+        std::string column_name;
+        std::string type;
+        bool extension;
+      };
+
+      std::map<std::string, std::string> _aliases;
+      std::map<std::string, struct_def> _structs;
+      std::map<std::string, std::string> _tables;
+      std::map<std::string, std::vector<leaf>> _plans;
+
+      std::string resolve(const std::string& type) const;
+      void plan(const std::string& type, const std::string& prefix, bool extension, std::vector<leaf>& leaves, int depth) const;
+      const std::vector<leaf>& plan_for(const std::string& table) const;
+  };
+
+  std::string name_to_string(uint64_t value);
+  std::string symbol_to_string(uint64_t value);
+
+}
@@ -0,0 +1,193 @@
+#include "columnar.hpp"
+
+#include <stdexcept>
+
+namespace decosnap {
+
+  namespace {
+
+    const char magic[4] = { 'D', 'C', 'O', 'L' };
+    const uint32_t version = 1;
+
+    void put_u64(std::ostream& out, uint64_t value) {
+      for(int i = 0; i < 8; i++)
+        out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    void put_u32(std::ostream& out, uint32_t value) {
+      for(int i = 0; i < 4; i++)
+        out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    void put_str(std::ostream& out, const std::string& value) {
+      put_u32(out, static_cast<uint32_t>(value.size()));
+      out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    uint64_t get_u64(std::istream& in) {
+      unsigned char bytes[8];
+      if(!in.read(reinterpret_cast<char*>(bytes), 8))
+        throw std::runtime_error("snapshot: truncated file");
+      uint64_t value = 0;
+      for(int i = 7; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+      return value;
+    }
+
+    uint32_t get_u32(std::istream& in) {
+      unsigned char bytes[4];
+      if(!in.read(reinterpret_cast<char*>(bytes), 4))
+        throw std::runtime_error("snapshot: truncated file");
+      return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    std::string get_str(std::istream& in) {
+      std::string value(get_u32(in), '\0');
+      if(!in.read(&value[0], static_cast<std::streamsize>(value.size())))
+        throw std::runtime_error("snapshot: truncated file");
+      return value;
+    }
+
+  }
+
+  size_t column::size() const {
+    switch(kind) {
+      case column_kind::i64: return i64s.size();
+      case column_kind::u64: return u64s.size();
+      case column_kind::u128: return u128s.size();
+      case column_kind::str: return strs.size();
+    }
+    return 0;
+  }
+
+  int64_t column::int_at(size_t row) const {
+    switch(kind) {
+      case column_kind::i64: return i64s.at(row);
+      case column_kind::u64: return static_cast<int64_t>(u64s.at(row));
+      case column_kind::u128: return static_cast<int64_t>(u128s.at(row));
+      case column_kind::str: break;
+    }
+    throw std::runtime_error("snapshot: column " + name + " is not an integer");
+  }
+
+  const std::string& column::str_at(size_t row) const {
+    if(kind != column_kind::str)
+      throw std::runtime_error("snapshot: column " + name + " is not a string");
+    return strs.at(row);
+  }
+
+  const column& table_snapshot::at(const std::string& column_name) const {
+    for(const auto& col : columns) {
+      if(col.name == column_name)
+        return col;
+    }
+    throw std::runtime_error("snapshot: table " + name + " has no column " + column_name);
+  }
+
+  const table_snapshot* snapshot::find(const std::string& table_name) const {
+    for(const auto& table : tables) {
+      if(table.name == table_name)
+        return &table;
+    }
+    return nullptr;
+  }
+
+  void write_snapshot(const snapshot& snap, std::ostream& out) {
+    out.write(magic, sizeof(magic));
+    put_u32(out, version);
+    put_u32(out, static_cast<uint32_t>(snap.tables.size()));
+
+    for(const auto& table : snap.tables) {
+      put_str(out, table.name);
+      put_u64(out, table.rows);
+      put_u32(out, static_cast<uint32_t>(table.columns.size()));
+
+      for(const auto& col : table.columns) {
+        put_str(out, col.name);
+        out.put(static_cast<char>(col.kind));
+      }
+
+      for(const auto& col : table.columns) {
+        if(col.size() != table.rows)
+          throw std::runtime_error("snapshot: column " + col.name + " has the wrong number of rows");
+
+        switch(col.kind) {
+          case column_kind::i64:
+            for(int64_t value : col.i64s)
+              put_u64(out, static_cast<uint64_t>(value));
+            break;
+          case column_kind::u64:
+            for(uint64_t value : col.u64s)
+              put_u64(out, value);
+            break;
+          case column_kind::u128:
+            for(__uint128_t value : col.u128s) {
+              put_u64(out, static_cast<uint64_t>(value));
+              put_u64(out, static_cast<uint64_t>(value >> 64));
+            }
+            break;
+          case column_kind::str:
+            for(const auto& value : col.strs)
+              put_str(out, value);
+            break;
+        }
+      }
+    }
+
+    if(!out)
+      throw std::runtime_error("snapshot: write failed");
+  }
+
+  snapshot read_snapshot(std::istream& in) {
+    char header[4];
+    if(!in.read(header, sizeof(header)) || std::string(header, 4) != std::string(magic, 4))
+      throw std::runtime_error("snapshot: not a DCOL file");
+    if(get_u32(in) != version)
+      throw std::runtime_error("snapshot: unsupported version");
+
+    snapshot snap;
+    uint32_t table_count = get_u32(in);
+
+    for(uint32_t t = 0; t < table_count; t++) {
+      table_snapshot table;
+      table.name = get_str(in);
+      table.rows = get_u64(in);
+      table.columns.resize(get_u32(in));
+
+      for(auto& col : table.columns) {
+        col.name = get_str(in);
+        int kind = in.get();
+        if(kind < static_cast<int>(column_kind::i64) || kind > static_cast<int>(column_kind::str))
+          throw std::runtime_error("snapshot: bad column kind for " + col.name);
+        col.kind = static_cast<column_kind>(kind);
+      }
+
+      for(auto& col : table.columns) {
+        for(size_t row = 0; row < table.rows; row++) {
+          switch(col.kind) {
+            case column_kind::i64:
+              col.i64s.push_back(static_cast<int64_t>(get_u64(in)));
+              break;
+            case column_kind::u64:
+              col.u64s.push_back(get_u64(in));
+              break;
+            case column_kind::u128: {
+              __uint128_t low = get_u64(in);
+              __uint128_t high = get_u64(in);
+              col.u128s.push_back(low | (high << 64));
+              break;
+            }
+            case column_kind::str:
+              col.strs.push_back(get_str(in));
+              break;
+          }
+        }
+      }
+
+      snap.tables.push_back(std::move(table));
+    }
+
+    return snap;
+  }
+
+}
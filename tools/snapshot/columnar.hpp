@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace decosnap {
+
+  enum class column_kind : uint8_t { i64 = 1, u64 = 2, u128 = 3, str = 4 };
+
+  // One column of a table, only the vector matching the kind is filled
+  struct column {
+    std::string name;
+    column_kind kind;
+    std::vector<int64_t> i64s;
+    std::vector<uint64_t> u64s;
+    std::vector<__uint128_t> u128s;
+    std::vector<std::string> strs;
+
+    size_t size() const;
+
+    // Integer value of the row whatever the integer kind, throws for strings
+    int64_t int_at(size_t row) const;
+    const std::string& str_at(size_t row) const;
+  };
+
+  struct table_snapshot {
+    std::string name;
+    size_t rows = 0;
+    std::vector<column> columns;
+
+    // Column by name, throws when it is missing
+    const column& at(const std::string& column_name) const;
+  };
+
+  struct snapshot {
+    std::vector<table_snapshot> tables;
+
+    // Table by name, nullptr when it was not exported
+    const table_snapshot* find(const std::string& table_name) const;
+  };
+
+  // The file starts with DCOL and a version, then every table with its columns stored one after the other
+  void write_snapshot(const snapshot& snap, std::ostream& out);
+  snapshot read_snapshot(std::istream& in);
+
+}
@@ -0,0 +1,232 @@
+#include "json.hpp"
+
+#include <cctype>
+#include <stdexcept>
+
+namespace decosnap {
+
+  namespace {
+
+    class parser {
+      public:
+        explicit parser(const std::string& input) : _input(input) {}
+
+        json_value parse_document() {
+          json_value value = parse_value();
+          skip_space();
+          if(_pos != _input.size())
+            fail("trailing characters");
+          return value;
+        }
+
+      private:
+        const std::string& _input;
+        size_t _pos = 0;
+
+        [[noreturn]] void fail(const std::string& what) {
+          throw std::runtime_error("json: " + what + " at offset " + std::to_string(_pos));
+        }
+
+        void skip_space() {
+          while(_pos < _input.size() && std::isspace(static_cast<unsigned char>(_input[_pos])))
+            _pos++;
+        }
+
+        char peek() {
+          skip_space();
+          if(_pos >= _input.size())
+            fail("unexpected end of input");
+          return _input[_pos];
+        }
+
+        void expect(char c) {
+          if(peek() != c)
+            fail(std::string("expected '") + c + "'");
+          _pos++;
+        }
+
+        void expect_word(const std::string& word) {
+          if(_input.compare(_pos, word.size(), word) != 0)
+            fail("expected " + word);
+          _pos += word.size();
+        }
+
+        json_value parse_value() {
+          json_value value;
+          char c = peek();
+
+          if(c == '{') {
+            value.kind = json_value::object_kind;
+            _pos++;
+            if(peek() == '}') {
+              _pos++;
+              return value;
+            }
+            while(true) {
+              std::string key = parse_string();
+              expect(':');
+              value.members[key] = parse_value();
+              if(peek() == ',') {
+                _pos++;
+                continue;
+              }
+              expect('}');
+              return value;
+            }
+          }
+
+          if(c == '[') {
+            value.kind = json_value::array_kind;
+            _pos++;
+            if(peek() == ']') {
+              _pos++;
+              return value;
+            }
+            while(true) {
+              value.items.push_back(parse_value());
+              if(peek() == ',') {
+                _pos++;
+                continue;
+              }
+              expect(']');
+              return value;
+            }
+          }
+
+          if(c == '"') {
+            value.kind = json_value::string_kind;
+            value.text = parse_string();
+            return value;
+          }
+
+          if(c == 't') {
+            expect_word("true");
+            value.kind = json_value::bool_kind;
+            value.boolean = true;
+            return value;
+          }
+
+          if(c == 'f') {
+            expect_word("false");
+            value.kind = json_value::bool_kind;
+            return value;
+          }
+
+          if(c == 'n') {
+            expect_word("null");
+            return value;
+          }
+
+          // Numbers are kept as text, the ABI has none that are needed
+          value.kind = json_value::number_kind;
+          size_t start = _pos;
+          while(_pos < _input.size() && (std::isdigit(static_cast<unsigned char>(_input[_pos])) || std::string("+-.eE").find(_input[_pos]) != std::string::npos))
+            _pos++;
+          if(start == _pos)
+            fail("unexpected character");
+          value.text = _input.substr(start, _pos - start);
+          return value;
+        }
+
+        void append_utf8(std::string& out, uint32_t cp) {
+          if(cp < 0x80) {
+            out += static_cast<char>(cp);
+          } else if(cp < 0x800) {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+          } else if(cp < 0x10000) {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+          } else {
+            out += static_cast<char>(0xf0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+          }
+        }
+
+        uint32_t parse_hex4() {
+          if(_pos + 4 > _input.size())
+            fail("short unicode escape");
+          uint32_t cp = std::stoul(_input.substr(_pos, 4), nullptr, 16);
+          _pos += 4;
+          return cp;
+        }
+
+        std::string parse_string() {
+          expect('"');
+          std::string out;
+          while(true) {
+            if(_pos >= _input.size())
+              fail("unterminated string");
+            char c = _input[_pos++];
+            if(c == '"')
+              return out;
+            if(c != '\\') {
+              out += c;
+              continue;
+            }
+            if(_pos >= _input.size())
+              fail("unterminated escape");
+            char e = _input[_pos++];
+            switch(e) {
+              case '"': out += '"'; break;
+              case '\\': out += '\\'; break;
+              case '/': out += '/'; break;
+              case 'b': out += '\b'; break;
+              case 'f': out += '\f'; break;
+              case 'n': out += '\n'; break;
+              case 'r': out += '\r'; break;
+              case 't': out += '\t'; break;
+              case 'u': {
+                uint32_t cp = parse_hex4();
+                // Surrogate pair
+                if(cp >= 0xd800 && cp < 0xdc00 && _input.compare(_pos, 2, "\\u") == 0) {
+                  _pos += 2;
+                  uint32_t low = parse_hex4();
+                  cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                }
+                append_utf8(out, cp);
+                break;
+              }
+              default:
+                fail("bad escape");
+            }
+          }
+        }
+    };
+
+  }
+
+  const json_value& json_value::at(const std::string& key) const {
+    const json_value* value = find(key);
+    if(value == nullptr)
+      throw std::runtime_error("json: missing member " + key);
+    return *value;
+  }
+
+  const json_value* json_value::find(const std::string& key) const {
+    if(kind != object_kind)
+      throw std::runtime_error("json: not an object looking up " + key);
+    auto iterator = members.find(key);
+    return iterator == members.end() ? nullptr : &iterator->second;
+  }
+
+  const std::string& json_value::str() const {
+    if(kind != string_kind)
+      throw std::runtime_error("json: not a string");
+    return text;
+  }
+
+  const std::vector<json_value>& json_value::array() const {
+    if(kind != array_kind)
+      throw std::runtime_error("json: not an array");
+    return items;
+  }
+
+  json_value parse_json(const std::string& input) {
+    return parser(input).parse_document();
+  }
+
+}
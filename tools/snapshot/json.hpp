@@ -0,0 +1,32 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace decosnap {
+
+  // Just enough JSON to read a contract ABI
+  struct json_value {
+    enum kind_t { null_kind, bool_kind, number_kind, string_kind, array_kind, object_kind };
+
+    kind_t kind = null_kind;
+    bool boolean = false;
+    std::string text;
+    std::vector<json_value> items;
+    std::map<std::string, json_value> members;
+
+    // Member of an object, throws when it is missing
+    const json_value& at(const std::string& key) const;
+
+    // Member of an object, nullptr when it is missing
+    const json_value* find(const std::string& key) const;
+
+    const std::string& str() const;
+    const std::vector<json_value>& array() const;
+  };
+
+  json_value parse_json(const std::string& input);
+
+}
@@ -0,0 +1,146 @@
+#include "abi.hpp"
+#include "columnar.hpp"
+#include "json.hpp"
+#include "replay.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace decosnap;
+
+namespace {
+
+  void usage() {
+    std::cerr << "usage: decosnap export <abi> <dump> <snapshot>\n"
+              << "       decosnap replay <snapshot> <supply> <paid>\n";
+  }
+
+  std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in)
+      throw std::runtime_error("can't open " + path);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+  }
+
+  std::vector<uint8_t> from_hex(const std::string& hex, size_t line_no) {
+    if(hex.size() % 2 != 0)
+      throw std::runtime_error("dump: odd hex length on line " + std::to_string(line_no));
+
+    std::vector<uint8_t> bytes;
+    for(size_t i = 0; i < hex.size(); i += 2) {
+      size_t used = 0;
+      int value = std::stoi(hex.substr(i, 2), &used, 16);
+      if(used != 2)
+        throw std::runtime_error("dump: bad hex on line " + std::to_string(line_no));
+      bytes.push_back(static_cast<uint8_t>(value));
+    }
+    return bytes;
+  }
+
+  // Dump lines are "<table> <scope> <hex row>", the rows get_table_rows returns with json set to false
+  int export_snapshot(const std::string& abi_path, const std::string& dump_path, const std::string& out_path) {
+    abi_decoder decoder(parse_json(read_file(abi_path)));
+
+    std::map<std::string, table_snapshot> tables;
+    std::ifstream dump(dump_path);
+    if(!dump)
+      throw std::runtime_error("can't open " + dump_path);
+
+    std::string line;
+    size_t line_no = 0;
+    while(std::getline(dump, line)) {
+      line_no++;
+      if(line.empty() || line[0] == '#')
+        continue;
+
+      std::istringstream fields(line);
+      std::string table_name, scope, hex;
+      if(!(fields >> table_name >> scope >> hex))
+        throw std::runtime_error("dump: bad line " + std::to_string(line_no));
+      if(!decoder.has_table(table_name))
+        throw std::runtime_error("dump: the ABI has no table " + table_name);
+
+      auto iterator = tables.find(table_name);
+      if(iterator == tables.end()) {
+        table_snapshot table;
+        table.name = table_name;
+
+        column scope_column;
+        scope_column.name = "scope";
+        scope_column.kind = column_kind::str;
+        table.columns.push_back(scope_column);
+
+        for(auto& col : decoder.make_columns(table_name))
+          table.columns.push_back(col);
+
+        iterator = tables.emplace(table_name, table).first;
+      }
+
+      table_snapshot& table = iterator->second;
+
+      // The row is decoded into the columns after scope
+      decoder.decode_row(table_name, from_hex(hex, line_no), table.columns, 1);
+      table.columns[0].strs.push_back(scope);
+      table.rows++;
+    }
+
+    // Tables come out in name order and rows in dump order, so the same dump gives the same file
+    snapshot snap;
+    for(auto& entry : tables)
+      snap.tables.push_back(std::move(entry.second));
+
+    std::ofstream out(out_path, std::ios::binary);
+    if(!out)
+      throw std::runtime_error("can't create " + out_path);
+    write_snapshot(snap, out);
+
+    for(const auto& table : snap.tables)
+      std::cerr << table.name << ": " << table.rows << " rows, " << table.columns.size() << " columns\n";
+
+    return 0;
+  }
+
+  int replay_snapshot(const std::string& snapshot_path, const std::string& supply, const std::string& paid_path) {
+    std::ifstream in(snapshot_path, std::ios::binary);
+    if(!in)
+      throw std::runtime_error("can't open " + snapshot_path);
+    snapshot snap = read_snapshot(in);
+
+    std::ifstream paid(paid_path);
+    if(!paid)
+      throw std::runtime_error("can't open " + paid_path);
+
+    size_t used = 0;
+    int64_t supply_amount = std::stoll(supply, &used);
+    if(used != supply.size() || supply_amount < 0)
+      throw std::runtime_error("supply must be a non negative amount in the smallest unit");
+
+    return replay(snap, supply_amount, paid, std::cout) == 0 ? 0 : 1;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  try {
+    if(args.size() == 4 && args[0] == "export")
+      return export_snapshot(args[1], args[2], args[3]);
+    if(args.size() == 4 && args[0] == "replay")
+      return replay_snapshot(args[1], args[2], args[3]);
+  } catch(const std::exception& e) {
+    std::cerr << "decosnap: " << e.what() << "\n";
+    return 2;
+  }
+
+  usage();
+  return 2;
+}
@@ -0,0 +1,207 @@
+#include "replay.hpp"
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace decosnap {
+
+  namespace {
+
+    // The settings of contconfig the payouts depend on
+    struct config {
+      uint64_t apy;
+      uint64_t percentage_share_to_distribute;
+      int64_t double_reward_time;
+      int64_t early_withdraw_penalty;
+      int64_t referral_percentage;
+      int64_t having_a_referral_percentage;
+    };
+
+    const table_snapshot& require_table(const snapshot& snap, const std::string& name) {
+      const table_snapshot* table = snap.find(name);
+      if(table == nullptr)
+        throw std::runtime_error("replay: snapshot has no " + name + " table");
+      return *table;
+    }
+
+    config read_config(const snapshot& snap) {
+      const table_snapshot& table = require_table(snap, "contconfig");
+      if(table.rows != 1)
+        throw std::runtime_error("replay: contconfig must have exactly one row");
+
+      return config{
+        static_cast<uint64_t>(table.at("apy").int_at(0)),
+        static_cast<uint64_t>(table.at("percentage_share_to_distribute").int_at(0)),
+        table.at("double_reward_time").int_at(0),
+        table.at("early_withdraw_penalty").int_at(0),
+        table.at("referral_percentage").int_at(0),
+        table.at("having_a_referral_percentage").int_at(0)
+      };
+    }
+
+    // Same integer arithmetic as decocontract::interest_to_give
+    int64_t interest_to_give(const config& cfg, int64_t amt, int64_t no_of_days, int64_t maturity_days) {
+      if(no_of_days > maturity_days)
+        no_of_days = maturity_days;
+
+      int64_t interest = static_cast<int64_t>((amt * cfg.apy * no_of_days) / (365 * 100));
+      int64_t extra_interest = static_cast<int64_t>(((no_of_days / cfg.double_reward_time) * cfg.apy * amt) / (365 * 100));
+
+      return interest + extra_interest;
+    }
+
+    typedef std::pair<std::string, std::string> payout_key;
+
+  }
+
+  size_t replay(const snapshot& snap, int64_t supply, std::istream& paid, std::ostream& report) {
+
+    config cfg = read_config(snap);
+    const table_snapshot& bids = require_table(snap, "bids");
+    const table_snapshot& stakes = require_table(snap, "stakes");
+
+    // Keyed by kind and account, or by kind and stake key for withdraw and cancel
+    std::map<payout_key, int64_t> expected;
+
+    size_t mismatches = 0;
+    size_t drifted = 0;
+
+    // The totals are counted from the rows the way the contract did before pooltotals
+    int64_t counted_bid = 0;
+    for(size_t row = 0; row < bids.rows; row++)
+      counted_bid = counted_bid + bids.at("bid").int_at(row);
+
+    int64_t counted_staked = 0;
+    for(size_t row = 0; row < stakes.rows; row++) {
+      if(stakes.at("days_passed").int_at(row) > 0)
+        counted_staked = counted_staked + stakes.at("staked_amount").int_at(row);
+    }
+
+    // The contract pays from the stored pooltotals, so those are used when the snapshot has them
+    int64_t total_bid = counted_bid;
+    int64_t total_staked = counted_staked;
+
+    const table_snapshot* totals = snap.find("pooltotals");
+    if(totals != nullptr && totals->rows == 1) {
+      total_bid = totals->at("total_bid").int_at(0);
+      total_staked = totals->at("total_staked").int_at(0);
+
+      if(total_bid != counted_bid) {
+        drifted++;
+        report << "drift total_bid stored=" << total_bid << " counted=" << counted_bid << "\n";
+      }
+      if(total_staked != counted_staked) {
+        drifted++;
+        report << "drift total_staked stored=" << total_staked << " counted=" << counted_staked << "\n";
+      }
+    }
+
+    // distdivident
+    int64_t bidded_to_distribute = static_cast<int64_t>((cfg.percentage_share_to_distribute * total_bid) / 100);
+
+    for(size_t row = 0; row < stakes.rows; row++) {
+      int64_t days_passed = stakes.at("days_passed").int_at(row);
+      int64_t staked_days = stakes.at("staked_days").int_at(row);
+      int64_t amount = stakes.at("staked_amount").int_at(row);
+      const std::string& staker = stakes.at("staker").str_at(row);
+      std::string key = std::to_string(stakes.at("key").int_at(row));
+
+      if(days_passed > 0 && days_passed <= staked_days && total_staked > 0) {
+        int64_t tokens_to_give = (amount * bidded_to_distribute) / total_staked;
+        if(tokens_to_give > 0)
+          expected[{ "dividend", staker }] += tokens_to_give;
+      }
+
+      // What withdrawstake or cancelstake pays at this state of the stake
+      int64_t interest = interest_to_give(cfg, amount, days_passed, staked_days);
+      if(staked_days < days_passed)
+        expected[{ "withdraw", key }] = amount + interest;
+      else
+        expected[{ "cancel", key }] = (((100 - cfg.early_withdraw_penalty) * amount) / 100) + interest;
+    }
+
+    // distribute
+    for(size_t row = 0; row < bids.rows && total_bid > 0; row++) {
+      const std::string& bidder = bids.at("biddername").str_at(row);
+      const std::string& referrer = bids.at("referrer").str_at(row);
+
+      int64_t tokens_to_send = (bids.at("bid").int_at(row) * supply) / total_bid;
+      if(tokens_to_send <= 0) {
+        mismatches++;
+        report << "abort distribute would fail, the share of " << bidder << " is 0\n";
+      }
+
+      int64_t referral_share = (cfg.referral_percentage * tokens_to_send) / 100;
+
+      if(referrer.length() > 0 && referral_share > 0) {
+        expected[{ "referral", referrer }] += referral_share;
+        tokens_to_send = tokens_to_send + (cfg.having_a_referral_percentage * tokens_to_send) / 100;
+      }
+
+      if(tokens_to_send > 0)
+        expected[{ "bid", bidder }] += tokens_to_send;
+    }
+
+    // Paid lines are "<kind> <account> <amount> [<key>]", the amount in the smallest unit
+    std::map<payout_key, int64_t> actual;
+    std::string line;
+    size_t line_no = 0;
+
+    while(std::getline(paid, line)) {
+      line_no++;
+      if(line.empty() || line[0] == '#')
+        continue;
+
+      std::istringstream fields(line);
+      std::string kind, account, key;
+      int64_t amount;
+      if(!(fields >> kind >> account >> amount))
+        throw std::runtime_error("replay: bad paid line " + std::to_string(line_no));
+      fields >> key;
+
+      if(kind == "withdraw" || kind == "cancel") {
+        if(key.empty())
+          throw std::runtime_error("replay: " + kind + " needs the stake key on line " + std::to_string(line_no));
+        actual[{ kind, key }] += amount;
+      } else if(kind == "dividend" || kind == "bid" || kind == "referral") {
+        actual[{ kind, account }] += amount;
+      } else {
+        throw std::runtime_error("replay: unknown kind " + kind + " on line " + std::to_string(line_no));
+      }
+    }
+
+    size_t checked = 0;
+
+    for(const auto& entry : expected) {
+      bool per_stake = entry.first.first == "withdraw" || entry.first.first == "cancel";
+      auto paid_itr = actual.find(entry.first);
+
+      // A stake that was not withdrawn or cancelled has nothing to compare
+      if(per_stake && paid_itr == actual.end())
+        continue;
+
+      checked++;
+      int64_t paid_amount = paid_itr == actual.end() ? 0 : paid_itr->second;
+      if(paid_amount != entry.second) {
+        mismatches++;
+        report << entry.first.first << " " << entry.first.second << " expected=" << entry.second << " paid=" << paid_amount << "\n";
+      }
+    }
+
+    for(const auto& entry : actual) {
+      if(expected.count(entry.first) > 0)
+        continue;
+
+      checked++;
+      mismatches++;
+      report << entry.first.first << " " << entry.first.second << " expected=0 paid=" << entry.second << "\n";
+    }
+
+    report << "checked " << checked << ", mismatched " << mismatches << ", drifted totals " << drifted << "\n";
+    return mismatches + drifted;
+  }
+
+}
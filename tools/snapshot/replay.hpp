@@ -0,0 +1,14 @@
+#pragma once
+
+#include "columnar.hpp"
+
+#include <istream>
+#include <ostream>
+
+namespace decosnap {
+
+  // Recompute distdivident, distribute and interest_to_give from a snapshot taken before they ran and
+  // diff them against the paid amounts, returns the number of mismatches, aborts and drifted totals
+  size_t replay(const snapshot& snap, int64_t supply, std::istream& paid, std::ostream& report);
+
+}